@@ -0,0 +1,48 @@
+#ifndef ANALYSISSERVER_H
+#define ANALYSISSERVER_H
+
+#include "functional"
+#include "string"
+#include "vector"
+#include "llvm/IR/Module.h"
+
+namespace spatial {
+class Token;
+}
+
+// Answers points-to queries over a Unix domain socket against an already
+// solved module. Every request and response is a frame: a 4 byte big-endian
+// payload length followed by newline separated lines, one per query:
+//   points-to <function> <value>
+//   may-alias <function> <value> <value>
+//   changed <function>
+//   shutdown
+// Each query gets one response line starting with "ok" or "error".
+class AnalysisServer {
+public:
+  // Collects the pointees of a value at the return of a function, false if
+  // the function never returns
+  using QueryFn = std::function<bool(llvm::Function &, llvm::Value *,
+                                     std::vector<spatial::Token *> &)>;
+  // Re-analyzes a changed function, returns an error message on failure
+  using UpdateFn = std::function<std::string(llvm::Function &)>;
+
+  AnalysisServer(llvm::Module *M, QueryFn Query, UpdateFn Update)
+      : M(M), Query(Query), Update(Update) {}
+
+  // Blocks serving clients one at a time until a shutdown query
+  int serve(const std::string &SocketPath);
+
+private:
+  llvm::Module *M;
+  QueryFn Query;
+  UpdateFn Update;
+  bool Running = true;
+
+  void serveClient(int Fd);
+  std::string handleFrame(const std::string &Frame);
+  std::string handleQuery(const std::vector<std::string> &Args);
+  llvm::Value *lookupValue(llvm::Function &F, std::string Name);
+};
+
+#endif
@@ -3,13 +3,42 @@
 
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
+#include "vector"
+
+namespace spatial {
+class Token;
+}
+
+namespace ContextSensitiveAA {
+class PointsToAnalysis;
+}
 
 class ContextSensitivePointsToAnalysisPass : public llvm::ModulePass {
+private:
+  // Evaluate benchmark queries after the analysis converges
+  bool EvaluateBenchmark;
+  // Dump the per-instruction points-to information after the run
+  bool PrintResults;
+  // Solved analysis kept alive to answer queries after the run
+  ContextSensitiveAA::PointsToAnalysis *PA;
+
 public:
   static char ID;
-  ContextSensitivePointsToAnalysisPass() : ModulePass(ID) {}
+  ContextSensitivePointsToAnalysisPass(bool EvaluateBenchmark = true,
+                                       bool PrintResults = true)
+      : ModulePass(ID), EvaluateBenchmark(EvaluateBenchmark),
+        PrintResults(PrintResults), PA(nullptr) {}
+  ~ContextSensitivePointsToAnalysisPass() override;
 
   bool runOnModule(llvm::Module &M) override;
+  // Drops the results depending on F before its body is replaced
+  void invalidateFunction(llvm::Function &F);
+  // Solves the results dropped by invalidateFunction again
+  void reanalyzeFunction(llvm::Function &F);
+  // Collects the pointees of V at the return of F, false if the pass has
+  // not run or F never returns
+  bool getPointsTo(llvm::Function &F, llvm::Value *V,
+                   std::vector<spatial::Token *> &Result);
 };
 
 #endif
@@ -5,9 +5,14 @@
 #include "llvm/Pass.h"
 
 class FlowInsensitivePointsToAnalysisPass : public llvm::ModulePass {
+private:
+  // Evaluate benchmark queries after the analysis converges
+  bool EvaluateBenchmark;
+
 public:
   static char ID;
-  FlowInsensitivePointsToAnalysisPass() : ModulePass(ID) {}
+  FlowInsensitivePointsToAnalysisPass(bool EvaluateBenchmark = true)
+      : ModulePass(ID), EvaluateBenchmark(EvaluateBenchmark) {}
 
   bool runOnModule(llvm::Module &M) override;
 };
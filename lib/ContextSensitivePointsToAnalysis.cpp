@@ -1,6 +1,8 @@
 #include "ContextSensitivePointsToAnalysis.h"
+#include "algorithm"
 #include "iostream"
 #include "map"
+#include "set"
 #include "spatial/Benchmark/PTABenchmark.h"
 #include "spatial/Graph/Graph.h"
 #include "spatial/InstModel/GenericInstModel/GenericInstModel.h"
@@ -24,17 +26,42 @@ private:
   spatial::TokenWrapper TW;
   spatial::GenericInstModel *IM;
   spatial::PTABenchmarkRunner *Bench;
+  std::vector<llvm::Instruction *> BenchQueries;
   std::stack<std::pair<spatial::Context, llvm::Instruction *>> WorkList;
   spatial::ValueContext<PointsToGraph> VC;
+  // Call sites using the result of each context, including reused contexts
+  std::map<spatial::Context,
+           std::set<std::pair<spatial::Context, llvm::Instruction *>>>
+      CallSites;
+  // Contexts to solve again with their function and entry value
+  std::map<spatial::Context, std::pair<llvm::Function *, PointsToGraph>>
+      Invalidated;
 
 public:
-  PointsToAnalysis(Module &M, PointsToGraph BI, PointsToGraph Top)
+  PointsToAnalysis(Module &M, PointsToGraph BI, PointsToGraph Top,
+                   bool EvaluateBenchmark)
       : VC(BI, Top) {
     IM = new spatial::GenericInstModel(&TW);
-    Bench = new spatial::PTABenchmarkRunner();
+    Bench = nullptr;
+    if (EvaluateBenchmark) {
+      Bench = new spatial::PTABenchmarkRunner();
+      initializeBenchQueries(M);
+    }
     initializeWorkList(M, BI);
     handleGlobalVar(M);
   }
+  ~PointsToAnalysis() {
+    delete Bench;
+    delete IM;
+  }
+  void initializeBenchQueries(llvm::Module &M) {
+    for (Function &F : M.functions()) {
+      for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+        if (Bench->extract(&*I).size() == 2)
+          BenchQueries.push_back(&*I);
+      }
+    }
+  }
   void handleGlobalVar(llvm::Module &M) {
     // Handle global variables
     for (auto &G : M.getGlobalList()) {
@@ -178,6 +205,7 @@ public:
             // update context graph
             VC.updateContextGraph(C, CallContext, Inst);
           }
+          CallSites[CallContext].insert(std::make_pair(C, Inst));
           // handle return value
           if (llvm::CallInst *CI = llvm::dyn_cast<CallInst>(Inst)) {
             if (!CI->doesNotReturn()) {
@@ -213,18 +241,116 @@ public:
     }
     if (&ParentBB->back() == Inst) {
       VC.setResult(C, VC.getDataFlowOut[C][Inst]);
-      for (auto T : VC.getContextChild(C)) {
+      for (auto T : CallSites[C]) {
         WorkList.push(T);
       }
     }
-    // Evaluate precision
-    auto BenchVar = Bench->extract(Inst);
-    if (BenchVar.size() == 2) {
-      Bench->evaluate(
-          Inst, VC.getDataFlowOut[C][Inst].getPointee(TW.getToken(BenchVar[0])),
-          VC.getDataFlowOut[C][Inst].getPointee(TW.getToken(BenchVar[1])));
+  }
+  void evaluateBenchQueries() {
+    if (!Bench)
+      return;
+    // Evaluate precision against the fixpoint of every context
+    for (llvm::Instruction *Inst : BenchQueries) {
+      auto BenchVar = Bench->extract(Inst);
+      for (auto C : VC.getContexts(Inst->getFunction())) {
+        // Skip query points the solver never reached in this context
+        if (VC.getDataFlowOut[C].find(Inst) == VC.getDataFlowOut[C].end())
+          continue;
+        Bench->evaluate(
+            Inst,
+            VC.getDataFlowOut[C][Inst].getPointee(TW.getToken(BenchVar[0])),
+            VC.getDataFlowOut[C][Inst].getPointee(TW.getToken(BenchVar[1])));
+      }
     }
   }
+  void invalidateFunction(llvm::Function &F) {
+    // Contexts are keyed by their entry value, so only the contexts of F and
+    // the callers consuming their results have to be solved again
+    std::vector<std::pair<spatial::Context, llvm::Function *>> Pending;
+    for (auto C : VC.getContexts(&F))
+      Pending.push_back(std::make_pair(C, &F));
+    while (!Pending.empty()) {
+      spatial::Context C;
+      llvm::Function *G;
+      std::tie(C, G) = Pending.back();
+      Pending.pop_back();
+      if (Invalidated.count(C))
+        continue;
+      Invalidated[C] =
+          std::make_pair(G, VC.getDataFlowIn[C][&G->front().front()]);
+      auto Callers = CallSites.find(C);
+      if (Callers == CallSites.end())
+        continue;
+      for (auto T : Callers->second)
+        Pending.push_back(std::make_pair(T.first, T.second->getFunction()));
+    }
+    // Call sites of invalidated contexts are recorded again when solved, this
+    // also drops the ones from the body of F that is about to be replaced
+    for (auto &Callers : CallSites) {
+      for (auto It = Callers.second.begin(); It != Callers.second.end();) {
+        if (Invalidated.count(It->first))
+          It = Callers.second.erase(It);
+        else
+          ++It;
+      }
+    }
+    for (auto &I : Invalidated) {
+      spatial::Context C = I.first;
+      llvm::Function *G = I.second.first;
+      for (inst_iterator II = inst_begin(G), E = inst_end(G); II != E; ++II) {
+        VC.getDataFlowIn[C].erase(&*II);
+        VC.getDataFlowOut[C].erase(&*II);
+      }
+    }
+    BenchQueries.erase(std::remove_if(BenchQueries.begin(), BenchQueries.end(),
+                                      [&F](llvm::Instruction *I) {
+                                        return I->getFunction() == &F;
+                                      }),
+                       BenchQueries.end());
+  }
+  void reanalyzeFunction(llvm::Function &F) {
+    spatial::InstNamer(F);
+    if (Bench) {
+      for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+        if (Bench->extract(&*I).size() == 2)
+          BenchQueries.push_back(&*I);
+      }
+    }
+    for (auto &I : Invalidated) {
+      llvm::Instruction *Entry = &I.second.first->front().front();
+      VC.getDataFlowIn[I.first][Entry] = I.second.second;
+      WorkList.push(std::make_pair(I.first, Entry));
+    }
+    Invalidated.clear();
+    runOnWorklist();
+  }
+  llvm::ReturnInst *getReturnInst(llvm::Function &F) {
+    // UnifyFunctionExitNodes leaves at most one return per function
+    for (llvm::BasicBlock &BB : F) {
+      if (ReturnInst *RI = dyn_cast<ReturnInst>(BB.getTerminator()))
+        return RI;
+    }
+    return nullptr;
+  }
+  bool getPointsTo(llvm::Function &F, llvm::Value *V,
+                   std::vector<spatial::Token *> &Result) {
+    if (F.isDeclaration())
+      return false;
+    ReturnInst *RI = getReturnInst(F);
+    if (!RI)
+      return false;
+    // Merge the results at the return over all contexts
+    for (auto C : VC.getContexts(&F)) {
+      auto Out = VC.getDataFlowOut[C].find(RI);
+      if (Out == VC.getDataFlowOut[C].end())
+        continue;
+      for (auto *T : Out->second.getPointee(TW.getToken(V))) {
+        if (std::find(Result.begin(), Result.end(), T) == Result.end())
+          Result.push_back(T);
+      }
+    }
+    return true;
+  }
   void printContextResults(llvm::Module &M) {
     for (Function &F : M.functions()) {
       for (auto C : VC.getContexts(&F)) {
@@ -238,7 +364,8 @@ public:
         }
       }
     }
-    std::cout << *Bench;
+    if (Bench)
+      std::cout << *Bench;
   }
 };
 } // namespace ContextSensitiveAA
@@ -248,12 +375,36 @@ bool ContextSensitivePointsToAnalysisPass::runOnModule(Module &M) {
     spatial::InstNamer(F);
   }
   PointsToGraph BI, Top;
-  ContextSensitiveAA::PointsToAnalysis PA(M, BI, Top);
-  PA.runOnWorklist();
-  PA.printContextResults(M);
+  delete PA;
+  PA = new ContextSensitiveAA::PointsToAnalysis(M, BI, Top, EvaluateBenchmark);
+  PA->runOnWorklist();
+  PA->evaluateBenchQueries();
+  if (PrintResults)
+    PA->printContextResults(M);
   return false;
 }
 
+ContextSensitivePointsToAnalysisPass::~ContextSensitivePointsToAnalysisPass() {
+  delete PA;
+}
+
+void ContextSensitivePointsToAnalysisPass::invalidateFunction(Function &F) {
+  if (PA)
+    PA->invalidateFunction(F);
+}
+
+void ContextSensitivePointsToAnalysisPass::reanalyzeFunction(Function &F) {
+  if (PA)
+    PA->reanalyzeFunction(F);
+}
+
+bool ContextSensitivePointsToAnalysisPass::getPointsTo(
+    Function &F, Value *V, std::vector<spatial::Token *> &Result) {
+  if (!PA)
+    return false;
+  return PA->getPointsTo(F, V, Result);
+}
+
 char ContextSensitivePointsToAnalysisPass::ID = 0;
 static RegisterPass<ContextSensitivePointsToAnalysisPass>
     X("aa-cs",
@@ -13,10 +13,24 @@
 
 using namespace llvm;
 bool FlowInsensitivePointsToAnalysisPass::runOnModule(Module &M) {
+  for (Function &F : M.functions()) {
+    spatial::InstNamer(F);
+  }
   spatial::TokenWrapper TW;
   spatial::GenericInstModel IM(&TW);
   spatial::Graph<spatial::Token> AG;
-  spatial::PTABenchmarkRunner *Bench = new spatial::PTABenchmarkRunner();
+  spatial::PTABenchmarkRunner *Bench = nullptr;
+  // Collect benchmark query points before solving
+  std::vector<llvm::Instruction *> BenchQueries;
+  if (EvaluateBenchmark) {
+    Bench = new spatial::PTABenchmarkRunner();
+    for (Function &F : M.functions()) {
+      for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+        if (Bench->extract(&*I).size() == 2)
+          BenchQueries.push_back(&*I);
+      }
+    }
+  }
   // Handle global variables
   for (auto &G : M.getGlobalList()) {
     auto Tokens = IM.extractToken(&G);
@@ -32,7 +46,6 @@ bool FlowInsensitivePointsToAnalysisPass::runOnModule(Module &M) {
     }
   }
   for (Function &F : M.functions()) {
-    spatial::InstNamer(F);
     for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
       // Extract alias tokens from the instruction
       auto Tokens = IM.extractToken(&*I);
@@ -71,16 +84,19 @@ bool FlowInsensitivePointsToAnalysisPass::runOnModule(Module &M) {
           Redirections[1] = 0;
         AG.insert(Tokens[0], Tokens[1], Redirections[0], Redirections[1]);
       }
-      // Evaluate precision
-      auto BenchVar = Bench->extract(&*I);
-      if (BenchVar.size() == 2) {
-        Bench->evaluate(&*I, AG.getPointee(TW.getToken(BenchVar[0])),
-                        AG.getPointee(TW.getToken(BenchVar[1])));
-      }
     }
   }
   std::cout << AG;
-  std::cout << *Bench;
+  // Evaluate precision once the graph is complete
+  if (EvaluateBenchmark) {
+    for (llvm::Instruction *Inst : BenchQueries) {
+      auto BenchVar = Bench->extract(Inst);
+      Bench->evaluate(Inst, AG.getPointee(TW.getToken(BenchVar[0])),
+                      AG.getPointee(TW.getToken(BenchVar[1])));
+    }
+    std::cout << *Bench;
+  }
+  delete Bench;
   return false;
 }
 
@@ -1,4 +1,5 @@
 #include "FlowSensitivePointsToAnalysis.h"
+#include "algorithm"
 #include "iostream"
 #include "map"
 #include "set"
@@ -25,17 +26,36 @@ private:
   spatial::TokenWrapper *TW;
   spatial::GenericInstModel *IM;
   spatial::PTABenchmarkRunner *Bench;
+  std::vector<llvm::Instruction *> BenchQueries;
   std::stack<llvm::Instruction *> WorkList;
   std::map<llvm::Function *, std::set<llvm::Instruction *>> CallGraph;
+  std::set<llvm::Function *> Invalidated;
 
 public:
-  PointsToAnalysis(Module &M) {
+  PointsToAnalysis(Module &M, bool EvaluateBenchmark) {
     TW = new spatial::TokenWrapper();
     IM = new spatial::GenericInstModel(TW);
-    Bench = new spatial::PTABenchmarkRunner();
+    Bench = nullptr;
+    if (EvaluateBenchmark) {
+      Bench = new spatial::PTABenchmarkRunner();
+      initializeBenchQueries(M);
+    }
     initializeWorkList(M);
     handleGlobalVar(M);
   }
+  ~PointsToAnalysis() {
+    delete Bench;
+    delete IM;
+    delete TW;
+  }
+  void initializeBenchQueries(llvm::Module &M) {
+    for (Function &F : M.functions()) {
+      for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+        if (Bench->extract(&*I).size() == 2)
+          BenchQueries.push_back(&*I);
+      }
+    }
+  }
   void handleGlobalVar(llvm::Module &M) {
     // Handle global variables
     for (auto &G : M.getGlobalList()) {
@@ -208,14 +228,105 @@ public:
       PointsToOut[Inst].insert(Tokens[0], Tokens[1], Redirections[0],
                                Redirections[1]);
     }
-    // Evaluate precision
-    auto BenchVar = Bench->extract(Inst);
-    if (BenchVar.size() == 2) {
+  }
+  void evaluateBenchQueries() {
+    if (!Bench)
+      return;
+    // Evaluate precision against the fixpoint
+    for (llvm::Instruction *Inst : BenchQueries) {
+      // Skip query points the solver never reached
+      if (PointsToOut.find(Inst) == PointsToOut.end())
+        continue;
+      auto BenchVar = Bench->extract(Inst);
       Bench->evaluate(Inst,
                       PointsToOut[Inst].getPointee(TW->getToken(BenchVar[0])),
                       PointsToOut[Inst].getPointee(TW->getToken(BenchVar[1])));
     }
   }
+  void invalidateFunction(llvm::Function &F) {
+    // Call sites merge into a single entry state per callee, so every
+    // function connected to F through calls has to be solved again
+    std::vector<llvm::Function *> Pending{&F};
+    Invalidated.insert(&F);
+    while (!Pending.empty()) {
+      llvm::Function *G = Pending.back();
+      Pending.pop_back();
+      std::vector<llvm::Function *> Connected;
+      auto Callers = CallGraph.find(G);
+      if (Callers != CallGraph.end()) {
+        for (Instruction *CI : Callers->second)
+          Connected.push_back(CI->getFunction());
+      }
+      for (auto &Callee : CallGraph) {
+        for (Instruction *CI : Callee.second) {
+          if (CI->getFunction() == G)
+            Connected.push_back(Callee.first);
+        }
+      }
+      for (llvm::Function *H : Connected) {
+        if (Invalidated.insert(H).second)
+          Pending.push_back(H);
+      }
+    }
+    for (llvm::Function *G : Invalidated) {
+      for (inst_iterator I = inst_begin(G), E = inst_end(G); I != E; ++I) {
+        PointsToIn.erase(&*I);
+        PointsToOut.erase(&*I);
+      }
+    }
+    // Call sites of invalidated functions are recorded again when solved
+    for (auto &Callee : CallGraph) {
+      for (auto It = Callee.second.begin(); It != Callee.second.end();) {
+        if (Invalidated.count((*It)->getFunction()))
+          It = Callee.second.erase(It);
+        else
+          ++It;
+      }
+    }
+    BenchQueries.erase(std::remove_if(BenchQueries.begin(), BenchQueries.end(),
+                                      [&F](llvm::Instruction *I) {
+                                        return I->getFunction() == &F;
+                                      }),
+                       BenchQueries.end());
+  }
+  void reanalyzeFunction(llvm::Function &F) {
+    spatial::InstNamer(F);
+    if (Bench) {
+      for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+        if (Bench->extract(&*I).size() == 2)
+          BenchQueries.push_back(&*I);
+      }
+    }
+    for (llvm::Function *G : Invalidated) {
+      if (!G->isDeclaration())
+        WorkList.push(&G->front().front());
+    }
+    Invalidated.clear();
+    runOnWorkList();
+  }
+  llvm::ReturnInst *getReturnInst(llvm::Function &F) {
+    // UnifyFunctionExitNodes leaves at most one return per function
+    for (llvm::BasicBlock &BB : F) {
+      if (ReturnInst *RI = dyn_cast<ReturnInst>(BB.getTerminator()))
+        return RI;
+    }
+    return nullptr;
+  }
+  bool getPointsTo(llvm::Function &F, llvm::Value *V,
+                   std::vector<spatial::Token *> &Result) {
+    if (F.isDeclaration())
+      return false;
+    ReturnInst *RI = getReturnInst(F);
+    if (!RI)
+      return false;
+    // Results at the return summarize the whole function
+    auto Out = PointsToOut.find(RI);
+    if (Out == PointsToOut.end())
+      return true;
+    for (auto *T : Out->second.getPointee(TW->getToken(V)))
+      Result.push_back(T);
+    return true;
+  }
   void printResults(llvm::Module &M) {
     for (Function &F : M.functions()) {
       for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
@@ -225,7 +336,8 @@ public:
         std::cout << "----------- " << std::endl;
       }
     }
-    std::cout << *Bench;
+    if (Bench)
+      std::cout << *Bench;
   }
 };
 } // namespace FlowSensitiveAA
@@ -234,12 +346,36 @@ bool FlowSensitivePointsToAnalysisPass::runOnModule(Module &M) {
   for (Function &F : M.functions()) {
     spatial::InstNamer(F);
   }
-  FlowSensitiveAA::PointsToAnalysis PA(M);
-  PA.runOnWorkList();
-  PA.printResults(M);
+  delete PA;
+  PA = new FlowSensitiveAA::PointsToAnalysis(M, EvaluateBenchmark);
+  PA->runOnWorkList();
+  PA->evaluateBenchQueries();
+  if (PrintResults)
+    PA->printResults(M);
   return false;
 }
 
+FlowSensitivePointsToAnalysisPass::~FlowSensitivePointsToAnalysisPass() {
+  delete PA;
+}
+
+void FlowSensitivePointsToAnalysisPass::invalidateFunction(Function &F) {
+  if (PA)
+    PA->invalidateFunction(F);
+}
+
+void FlowSensitivePointsToAnalysisPass::reanalyzeFunction(Function &F) {
+  if (PA)
+    PA->reanalyzeFunction(F);
+}
+
+bool FlowSensitivePointsToAnalysisPass::getPointsTo(
+    Function &F, Value *V, std::vector<spatial::Token *> &Result) {
+  if (!PA)
+    return false;
+  return PA->getPointsTo(F, V, Result);
+}
+
 char FlowSensitivePointsToAnalysisPass::ID = 0;
 static RegisterPass<FlowSensitivePointsToAnalysisPass>
     X("aa-fs", "Implementation of flow-sensitive points-to analysis in LLVM",
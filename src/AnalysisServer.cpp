@@ -0,0 +1,203 @@
+#include "AnalysisServer.h"
+#include "algorithm"
+#include "cstdint"
+#include "sstream"
+#include "spatial/Token/Token.h"
+#include "llvm/IR/InstIterator.h"
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace llvm;
+
+// Largest request accepted from a client, anything bigger drops the
+// connection
+static const uint32_t MaxFrameSize = 16 << 20;
+
+static bool readAll(int Fd, char *Buf, size_t Len) {
+  while (Len) {
+    ssize_t N = read(Fd, Buf, Len);
+    if (N < 0 && errno == EINTR)
+      continue;
+    if (N <= 0)
+      return false;
+    Buf += N;
+    Len -= N;
+  }
+  return true;
+}
+
+static bool writeAll(int Fd, const char *Buf, size_t Len) {
+  while (Len) {
+    // Do not let a client that hung up raise SIGPIPE
+    ssize_t N = send(Fd, Buf, Len, MSG_NOSIGNAL);
+    if (N < 0 && errno == EINTR)
+      continue;
+    if (N <= 0)
+      return false;
+    Buf += N;
+    Len -= N;
+  }
+  return true;
+}
+
+static bool readFrame(int Fd, std::string &Frame) {
+  unsigned char Header[4];
+  if (!readAll(Fd, reinterpret_cast<char *>(Header), 4))
+    return false;
+  uint32_t Len = (uint32_t(Header[0]) << 24) | (uint32_t(Header[1]) << 16) |
+                 (uint32_t(Header[2]) << 8) | uint32_t(Header[3]);
+  if (Len > MaxFrameSize) {
+    errs() << "Dropping client sending a frame of " << Len << " bytes\n";
+    return false;
+  }
+  Frame.resize(Len);
+  return !Len || readAll(Fd, &Frame[0], Len);
+}
+
+static bool writeFrame(int Fd, const std::string &Frame) {
+  uint32_t Len = Frame.size();
+  unsigned char Header[4] = {
+      static_cast<unsigned char>(Len >> 24),
+      static_cast<unsigned char>(Len >> 16),
+      static_cast<unsigned char>(Len >> 8), static_cast<unsigned char>(Len)};
+  return writeAll(Fd, reinterpret_cast<char *>(Header), 4) &&
+         writeAll(Fd, Frame.data(), Frame.size());
+}
+
+int AnalysisServer::serve(const std::string &SocketPath) {
+  sockaddr_un Addr = {};
+  Addr.sun_family = AF_UNIX;
+  if (SocketPath.size() >= sizeof(Addr.sun_path)) {
+    errs() << "Socket path is too long: " << SocketPath << "\n";
+    return 1;
+  }
+  std::copy(SocketPath.begin(), SocketPath.end(), Addr.sun_path);
+  int ServerFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (ServerFd < 0) {
+    errs() << "Unable to create socket\n";
+    return 1;
+  }
+  // Only replace a stale socket, never an unrelated file
+  struct stat Stat;
+  if (lstat(SocketPath.c_str(), &Stat) == 0) {
+    if (!S_ISSOCK(Stat.st_mode)) {
+      errs() << SocketPath << " exists and is not a socket\n";
+      close(ServerFd);
+      return 1;
+    }
+    unlink(SocketPath.c_str());
+  }
+  if (bind(ServerFd, reinterpret_cast<sockaddr *>(&Addr), sizeof(Addr)) < 0 ||
+      listen(ServerFd, 8) < 0) {
+    errs() << "Unable to listen on " << SocketPath << "\n";
+    close(ServerFd);
+    return 1;
+  }
+  while (Running) {
+    int ClientFd = accept(ServerFd, nullptr, nullptr);
+    if (ClientFd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      errs() << "Unable to accept on " << SocketPath << "\n";
+      close(ServerFd);
+      unlink(SocketPath.c_str());
+      return 1;
+    }
+    serveClient(ClientFd);
+    close(ClientFd);
+  }
+  close(ServerFd);
+  unlink(SocketPath.c_str());
+  return 0;
+}
+
+void AnalysisServer::serveClient(int Fd) {
+  std::string Frame;
+  while (Running && readFrame(Fd, Frame)) {
+    if (!writeFrame(Fd, handleFrame(Frame)))
+      return;
+  }
+}
+
+std::string AnalysisServer::handleFrame(const std::string &Frame) {
+  // Answer every query of a batch in a single response frame
+  std::istringstream Queries(Frame);
+  std::string Response, Line;
+  while (std::getline(Queries, Line)) {
+    std::istringstream Words(Line);
+    std::vector<std::string> Args;
+    std::string Word;
+    while (Words >> Word)
+      Args.push_back(Word);
+    if (Args.empty())
+      continue;
+    Response += handleQuery(Args) + "\n";
+  }
+  return Response;
+}
+
+std::string AnalysisServer::handleQuery(const std::vector<std::string> &Args) {
+  const std::string &Cmd = Args[0];
+  if (Cmd == "shutdown") {
+    Running = false;
+    return "ok";
+  }
+  if (Args.size() < 2)
+    return "error missing function name";
+  llvm::Function *F = M->getFunction(Args[1]);
+  if (!F || F->isDeclaration())
+    return "error unknown function " + Args[1];
+  if (Cmd == "changed" && Args.size() == 2) {
+    std::string Error = Update(*F);
+    if (!Error.empty())
+      return "error " + Error;
+    return "ok";
+  }
+  if (Cmd == "points-to" && Args.size() == 3) {
+    llvm::Value *V = lookupValue(*F, Args[2]);
+    if (!V)
+      return "error unknown value " + Args[2];
+    std::vector<spatial::Token *> Pointee;
+    if (!Query(*F, V, Pointee))
+      return "error function never returns " + Args[1];
+    std::ostringstream OS;
+    OS << "ok";
+    for (spatial::Token *T : Pointee)
+      OS << " " << *T;
+    return OS.str();
+  }
+  if (Cmd == "may-alias" && Args.size() == 4) {
+    llvm::Value *V1 = lookupValue(*F, Args[2]);
+    llvm::Value *V2 = lookupValue(*F, Args[3]);
+    if (!V1 || !V2)
+      return "error unknown value " + (V1 ? Args[3] : Args[2]);
+    // Tokens are uniqued by the token wrapper so pointer equality is enough
+    std::vector<spatial::Token *> Pointee1, Pointee2;
+    if (!Query(*F, V1, Pointee1) || !Query(*F, V2, Pointee2))
+      return "error function never returns " + Args[1];
+    for (spatial::Token *T : Pointee1) {
+      if (std::find(Pointee2.begin(), Pointee2.end(), T) != Pointee2.end())
+        return "ok yes";
+    }
+    return "ok no";
+  }
+  return "error malformed query " + Cmd;
+}
+
+llvm::Value *AnalysisServer::lookupValue(llvm::Function &F, std::string Name) {
+  // Accept names with or without the IR sigil
+  if (!Name.empty() && (Name[0] == '%' || Name[0] == '@'))
+    Name = Name.substr(1);
+  for (llvm::Argument &Arg : F.args()) {
+    if (Arg.getName() == Name)
+      return &Arg;
+  }
+  for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+    if (I->getName() == Name)
+      return &*I;
+  }
+  return M->getNamedValue(Name);
+}
@@ -1,39 +1,222 @@
+#include "AnalysisServer.h"
 #include "ContextSensitivePointsToAnalysis.h"
 #include "FlowInsensitivePointsToAnalysis.h"
 #include "FlowSensitivePointsToAnalysis.h"
+#include "map"
+#include "string"
+#include "vector"
+#include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/UnifyFunctionExitNodes.h"
 
 using namespace llvm;
 
-int main(int argc, char **argv) {
-  if (argc < 1)
-    return 1;
-  LLVMContext Context;
+static std::unique_ptr<Module> loadModule(const char *Path,
+                                          LLVMContext &Context) {
   SMDiagnostic Error;
-  std::unique_ptr<Module> M = parseIRFile(argv[1], Error, Context);
+  std::unique_ptr<Module> M = parseIRFile(Path, Error, Context);
+  if (!M)
+    return M;
   legacy::FunctionPassManager FPM(M.get());
   Pass *UEN = createUnifyFunctionExitNodesPass();
   FPM.add(UEN);
   for (Function &F : M.get()->functions()) {
     FPM.run(F);
   }
+  return M;
+}
+
+// Identified struct types of a module reread into the same context get
+// renamed with a numeric suffix, map them back onto the resident types
+class ResidentTypeRemapper : public ValueMapTypeRemapper {
+private:
+  std::map<Type *, Type *> Mapped;
+  bool Compatible = true;
+
+public:
+  ResidentTypeRemapper(Module &Resident, Module &Reread) {
+    std::map<std::string, StructType *> ResidentTypes;
+    for (StructType *ST : Resident.getIdentifiedStructTypes()) {
+      if (ST->hasName())
+        ResidentTypes[ST->getName().str()] = ST;
+    }
+    for (StructType *ST : Reread.getIdentifiedStructTypes()) {
+      if (!ST->hasName())
+        continue;
+      StringRef Name = ST->getName();
+      StringRef Base, Suffix;
+      std::tie(Base, Suffix) = Name.rsplit('.');
+      auto It = ResidentTypes.find(Name.str());
+      if (It == ResidentTypes.end() && !Suffix.empty() &&
+          Suffix.find_first_not_of("0123456789") == StringRef::npos)
+        It = ResidentTypes.find(Base.str());
+      if (It != ResidentTypes.end())
+        Mapped[ST] = It->second;
+    }
+    // Fields of a mapped struct have to match once remapped themselves
+    std::map<Type *, Type *> Structs = Mapped;
+    for (auto &P : Structs) {
+      StructType *ST = cast<StructType>(P.first);
+      StructType *ResidentST = cast<StructType>(P.second);
+      if (ST->isOpaque() != ResidentST->isOpaque() ||
+          ST->isPacked() != ResidentST->isPacked() ||
+          ST->getNumElements() != ResidentST->getNumElements()) {
+        Compatible = false;
+        continue;
+      }
+      for (unsigned I = 0; I < ST->getNumElements(); ++I) {
+        if (remapType(ST->getElementType(I)) != ResidentST->getElementType(I))
+          Compatible = false;
+      }
+    }
+  }
+  // False if a struct changed its fields and can not be mapped
+  bool isCompatible() const { return Compatible; }
+  Type *remapType(Type *T) override {
+    auto It = Mapped.find(T);
+    if (It != Mapped.end())
+      return It->second;
+    Type *R = T;
+    if (PointerType *PT = dyn_cast<PointerType>(T)) {
+      if (!PT->isOpaque())
+        R = PointerType::get(remapType(PT->getPointerElementType()),
+                             PT->getAddressSpace());
+    } else if (ArrayType *AT = dyn_cast<ArrayType>(T)) {
+      R = ArrayType::get(remapType(AT->getElementType()),
+                         AT->getNumElements());
+    } else if (VectorType *VT = dyn_cast<VectorType>(T)) {
+      R = VectorType::get(remapType(VT->getElementType()),
+                          VT->getElementCount());
+    } else if (FunctionType *FT = dyn_cast<FunctionType>(T)) {
+      std::vector<Type *> Params;
+      for (Type *P : FT->params())
+        Params.push_back(remapType(P));
+      R = FunctionType::get(remapType(FT->getReturnType()), Params,
+                            FT->isVarArg());
+    } else if (StructType *ST = dyn_cast<StructType>(T)) {
+      if (ST->isLiteral()) {
+        std::vector<Type *> Elements;
+        for (Type *E : ST->elements())
+          Elements.push_back(remapType(E));
+        R = StructType::get(T->getContext(), Elements, ST->isPacked());
+      }
+    }
+    Mapped[T] = R;
+    return R;
+  }
+};
+
+// Keep the solved module resident and answer queries over a socket
+template <typename AnalysisPass>
+static int runServer(const char *Path, const char *SocketPath,
+                     LLVMContext &Context, std::unique_ptr<Module> M) {
+  AnalysisPass *AAP = new AnalysisPass(false, false);
+  AAP->runOnModule(*M);
+  auto Query = [AAP](Function &F, Value *V,
+                     std::vector<spatial::Token *> &Result) {
+    return AAP->getPointsTo(F, V, Result);
+  };
+  // Replaced bodies stay allocated as tokens may still refer to their values
+  std::vector<BasicBlock *> Retired;
+  // Swap in the body of F from the reread file and re-solve what depends on
+  // it. Anything beyond a changed body needs a restart.
+  auto Update = [&](Function &F) -> std::string {
+    std::unique_ptr<Module> NewM = loadModule(Path, Context);
+    if (!NewM)
+      return "unable to read " + std::string(Path);
+    // Cloned debug info would add the compile units of every reread module
+    // to the resident one
+    StripDebugInfo(*NewM);
+    ResidentTypeRemapper TypeMapper(*M, *NewM);
+    if (!TypeMapper.isCompatible())
+      return "struct types of the module changed";
+    Function *NewF = NewM->getFunction(F.getName());
+    if (!NewF || NewF->isDeclaration() ||
+        TypeMapper.remapType(NewF->getFunctionType()) != F.getFunctionType())
+      return "signature of " + F.getName().str() + " changed";
+    ValueToValueMapTy VMap;
+    for (GlobalValue &GV : NewM->global_values()) {
+      GlobalValue *OldGV = M->getNamedValue(GV.getName());
+      if (!OldGV ||
+          TypeMapper.remapType(GV.getValueType()) != OldGV->getValueType())
+        return "globals of the module changed";
+      VMap[&GV] = OldGV;
+    }
+    auto NewArg = NewF->arg_begin();
+    for (Argument &Arg : F.args())
+      VMap[&*NewArg++] = &Arg;
+    AAP->invalidateFunction(F);
+    size_t FirstRetired = Retired.size();
+    while (!F.empty()) {
+      BasicBlock *BB = &F.front();
+      BB->removeFromParent();
+      Retired.push_back(BB);
+    }
+    for (size_t I = FirstRetired; I < Retired.size(); ++I)
+      Retired[I]->dropAllReferences();
+    // The swapped in body carries no debug info
+    F.clearMetadata();
+    SmallVector<ReturnInst *, 4> Returns;
+    CloneFunctionInto(&F, NewF, VMap, CloneFunctionChangeType::DifferentModule,
+                      Returns, "", nullptr, &TypeMapper);
+    AAP->reanalyzeFunction(F);
+    return "";
+  };
+  AnalysisServer Server(M.get(), Query, Update);
+  int Ret = Server.serve(SocketPath);
+  delete AAP;
+  for (BasicBlock *BB : Retired)
+    delete BB;
+  return Ret;
+}
+
+int main(int argc, char **argv) {
+  // -no-bench skips benchmark evaluation, drop it before picking the mode
+  bool EvaluateBenchmark = true;
+  std::vector<char *> Args;
+  for (int I = 0; I < argc; ++I) {
+    if (std::string(argv[I]) == "-no-bench")
+      EvaluateBenchmark = false;
+    else
+      Args.push_back(argv[I]);
+  }
+  argc = Args.size();
+  argv = Args.data();
+  if (argc < 2)
+    return 1;
+  LLVMContext Context;
+  std::unique_ptr<Module> M = loadModule(argv[1], Context);
+  // Server mode: PTDriver test.ll -serve <socket> [-cs]
+  if (argc >= 3 && std::string(argv[2]) == "-serve") {
+    if (argc < 4 || argc > 5 || (argc == 5 && std::string(argv[4]) != "-cs")) {
+      errs() << "Usage: " << argv[0] << " <file.ll> -serve <socket> [-cs]\n";
+      return 1;
+    }
+    if (!M)
+      return 1;
+    if (argc == 5)
+      return runServer<ContextSensitivePointsToAnalysisPass>(
+          argv[1], argv[3], Context, std::move(M));
+    return runServer<FlowSensitivePointsToAnalysisPass>(argv[1], argv[3],
+                                                        Context, std::move(M));
+  }
   // TODO Parse cli args elegantly
   if (argc == 2) {
     FlowInsensitivePointsToAnalysisPass *AAP =
-        new FlowInsensitivePointsToAnalysisPass();
+        new FlowInsensitivePointsToAnalysisPass(EvaluateBenchmark);
     AAP->runOnModule(*M);
   } else if (argc == 3) {
     FlowSensitivePointsToAnalysisPass *AAP =
-        new FlowSensitivePointsToAnalysisPass();
+        new FlowSensitivePointsToAnalysisPass(EvaluateBenchmark);
     AAP->runOnModule(*M);
   } else if (argc == 4) {
     ContextSensitivePointsToAnalysisPass *AAP =
-        new ContextSensitivePointsToAnalysisPass();
+        new ContextSensitivePointsToAnalysisPass(EvaluateBenchmark);
     AAP->runOnModule(*M);
   }
   return 0;
@@ -0,0 +1,120 @@
+#!/bin/bash
+# Exercise the server mode of PTDriver on sample.ll, flow-sensitive and
+# context-sensitive
+
+DRIVER="${DRIVER:-PTDriver}"
+DIR="$(cd "$(dirname "$0")" && pwd)"
+STATUS=0
+
+for MODE in "" "-cs"; do
+    echo "== server mode ${MODE:-(fs)}"
+    # The client rewrites the IR, so serve a copy of it
+    IR="/tmp/ptdriver-$$.ll"
+    SOCK="/tmp/ptdriver-$$.sock"
+    cp "$DIR/sample.ll" "$IR"
+
+    $DRIVER "$IR" -serve "$SOCK" $MODE > /dev/null &
+    PID=$!
+    for _ in $(seq 100); do
+        [ -S "$SOCK" ] && break
+        sleep 0.1
+    done
+
+    python3 - "$SOCK" "$IR" <<'CLIENT'
+import re, socket, struct, sys
+
+SOCK, IR = sys.argv[1], sys.argv[2]
+
+def connect():
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    s.connect(SOCK)
+    return s
+
+def recv_all(s, n):
+    buf = b""
+    while len(buf) < n:
+        chunk = s.recv(n - len(buf))
+        if not chunk:
+            return None
+        buf += chunk
+    return buf
+
+def request(s, queries):
+    payload = "".join(q + "\n" for q in queries).encode()
+    s.sendall(struct.pack(">I", len(payload)) + payload)
+    (n,) = struct.unpack(">I", recv_all(s, 4))
+    return recv_all(s, n).decode().splitlines()
+
+failed = 0
+def check(s, queries, expected):
+    global failed
+    got = request(s, queries)
+    for q, g, e in zip(queries, got, expected):
+        ok = re.fullmatch(e, g) is not None
+        failed += not ok
+        print("%s %s => %s" % ("PASS" if ok else "FAIL", q, g))
+    if len(got) != len(expected):
+        failed += 1
+        print("FAIL expected %d responses, got %d" % (len(expected), len(got)))
+
+def drop_line(fragment):
+    with open(IR) as f:
+        lines = f.readlines()
+    kept = [l for l in lines if fragment not in l]
+    assert len(kept) == len(lines) - 1, fragment
+    with open(IR, "w") as f:
+        f.writelines(kept)
+
+s = connect()
+# A batch is answered in a single frame, one line per query
+check(s, ["points-to main p",
+          "may-alias main p q",
+          "may-alias main x y",
+          "points-to nosuch p",
+          "points-to main nosuch",
+          "may-alias main p",
+          "bogus main",
+          "changed nosuch"],
+         ["ok .+", "ok yes", "ok no", "error unknown function nosuch",
+          "error unknown value nosuch", "error malformed query may-alias",
+          "error malformed query bogus", "error unknown function nosuch"])
+
+# Caller changed: main no longer passes q to test, so only p points to z
+drop_line("call void @_Z4testPPP1XS1_(%struct.X*** %q")
+check(s, ["changed main", "may-alias main p q", "points-to main p"],
+      ["ok", "ok no", "ok .+"])
+
+# Callee changed: test no longer stores through its argument, so the
+# caller loses the pointee of p as well
+drop_line("store %struct.X** %0, %struct.X*** %1")
+check(s, ["changed _Z4testPPP1XS1_", "points-to main p",
+          "may-alias main p q"],
+      ["ok", "ok", "ok no"])
+
+# Changing the caller again must see the callee's new result, and callees
+# reused by the swapped caller must still be changeable afterwards
+check(s, ["changed main", "points-to main p", "changed _Z4newXv",
+          "points-to main y"],
+      ["ok", "ok", "ok", "ok .+"])
+s.close()
+
+# An oversized frame drops the connection but keeps the server alive
+s = connect()
+s.sendall(struct.pack(">I", 0xffffffff))
+if s.recv(4):
+    failed += 1
+    print("FAIL oversized frame was not rejected")
+s.close()
+
+s = connect()
+check(s, ["shutdown"], ["ok"])
+s.close()
+sys.exit(1 if failed else 0)
+CLIENT
+    [ $? -eq 0 ] || STATUS=1
+
+    wait $PID || STATUS=1
+    rm -f "$IR"
+done
+
+exit $STATUS